@@ -18,6 +18,7 @@ RUSTFLAGS := -O
 # Rust source files
 RUST_SRC_DEV := device_driver.rs
 RUST_SRC_SYSFS := sysfs.rs
+RUST_SRC_SHARED := config.rs metrics.rs
 
 # Binary output names
 RUST_BIN_DEV := device_driver
@@ -48,10 +49,10 @@ uninstall_module:
 # Rust application targets
 rust_apps: $(RUST_BIN_DEV) $(RUST_BIN_SYSFS)
 
-$(RUST_BIN_DEV): $(RUST_SRC_DEV)
+$(RUST_BIN_DEV): $(RUST_SRC_DEV) $(RUST_SRC_SHARED)
 	$(RUSTC) $(RUSTFLAGS) -o $@ $<
 
-$(RUST_BIN_SYSFS): $(RUST_SRC_SYSFS)
+$(RUST_BIN_SYSFS): $(RUST_SRC_SYSFS) $(RUST_SRC_SHARED)
 	$(RUSTC) $(RUSTFLAGS) -o $@ $<
 
 clean_rust:
@@ -0,0 +1,379 @@
+// Configuration shared by the Rust applications.
+// Parses the command line options, reads a "key = value" file and watches it
+// with inotify so changes can be applied between two loop iterations without
+// restarting.
+
+use std::env;
+use std::ffi::CString;
+use std::fs::{self, File};
+use std::io::{Error, ErrorKind, Read};
+use std::os::raw::{c_char, c_int};
+use std::os::unix::ffi::OsStrExt;
+use std::os::unix::io::FromRawFd;
+use std::path::Path;
+use std::time::Instant;
+
+pub const DEFAULT_CONFIG_PATH: &str = "/etc/pwm_led_controller.conf";
+pub const DEFAULT_DEVICE_PATH: &str = "/dev/pwm_led_controller";          // Character device
+pub const DEFAULT_SYSFS_PATH: &str = "/sys/kernel/pwm_led_controller";    // Sysfs directory
+pub const LED_PINS_PARAM: &str = "/sys/module/pwm_led_controller/parameters/led_pins";
+const DEFAULT_LED_CHANNELS: usize = 3;
+#[allow(dead_code)]  // Only used by the sysfs client
+const SETTLED_SPEED_DELTA: f64 = 0.05;  // Smoothed speed this close to the sample counts as settled
+
+// inotify flags from <sys/inotify.h>
+const IN_NONBLOCK: c_int = 0o4000;
+const IN_CLOEXEC: c_int = 0o2000000;
+const IN_CLOSE_WRITE: u32 = 0x0000_0008;
+const IN_MOVED_TO: u32 = 0x0000_0080;
+const EVENT_HEADER_LEN: usize = 16;  // wd, mask, cookie and len fields
+
+extern "C" {
+    fn inotify_init1(flags: c_int) -> c_int;
+    fn inotify_add_watch(fd: c_int, pathname: *const c_char, mask: u32) -> c_int;
+}
+
+// led_channel_count - Returns the number of LED channels the module was loaded with
+// The module parameter lists one pin per channel; falls back to 3 if it cannot be read
+
+pub fn led_channel_count() -> usize {
+    match fs::read_to_string(LED_PINS_PARAM) {
+        Ok(pins) if !pins.trim().is_empty() => pins.trim().split(',').count(),
+        _ => DEFAULT_LED_CHANNELS,
+    }
+}
+
+// Options - Command line options, fixed for the lifetime of the process
+pub struct Options {
+    pub verbose: bool,          // Print every sample (-v)
+    pub metrics_path: String,   // Textfile collector output file (--metrics-file <path>)
+    pub config_path: String,    // Config file watched for changes (--config <path>)
+}
+
+// parse_args - Reads the command line options
+pub fn parse_args(default_metrics_path: &str) -> Options {
+    let mut options = Options {
+        verbose: false,
+        metrics_path: default_metrics_path.to_string(),
+        config_path: DEFAULT_CONFIG_PATH.to_string(),
+    };
+
+    let mut args = env::args().skip(1);
+    while let Some(arg) = args.next() {
+        match arg.as_str() {
+            "-v" | "--verbose" => options.verbose = true,
+            "--metrics-file" | "--config" => match args.next() {
+                Some(path) if arg == "--metrics-file" => options.metrics_path = path,
+                Some(path) => options.config_path = path,
+                None => eprintln!("Ignoring option without a value: {}", arg),
+            },
+            _ => eprintln!("Ignoring unknown option: {}", arg),
+        }
+    }
+
+    options
+}
+
+// Config - Settings that can be changed while the application runs
+#[derive(Clone, PartialEq, Debug)]
+pub struct Config {
+    pub device_path: String,   // Character device used by the device driver client
+    pub sysfs_path: String,    // Sysfs directory used by the sysfs client
+    pub min_speed: f64,        // Speed mapped to the minimum brightness
+    pub max_speed: f64,        // Speed mapped to full brightness
+    pub led1_min: f64,         // LED1 duty cycle at min_speed
+    pub led2_threshold: f64,   // Fraction of the range where LED2 turns on
+    pub led2_gain: f64,        // LED2 duty cycle per unit of range above its threshold
+    pub led3_threshold: f64,   // Fraction of the range where LED3 turns on
+    pub led3_gain: f64,        // LED3 duty cycle per unit of range above its threshold
+    pub interval_ms: u64,      // Time between two samples, idle rate of the sysfs client
+    pub fast_interval_ms: u64, // Time between two samples while the speed changes (sysfs client)
+    pub smoothing: f64,        // Weight of a new speed sample per interval_ms, 1.0 disables smoothing
+}
+
+impl Config {
+    // new - Returns the built-in defaults
+    pub fn new() -> Config {
+        Config {
+            device_path: DEFAULT_DEVICE_PATH.to_string(),
+            sysfs_path: DEFAULT_SYSFS_PATH.to_string(),
+            min_speed: 1.0,
+            max_speed: 10.0,
+            led1_min: 10.0,
+            led2_threshold: 0.33,
+            led2_gain: 150.0,
+            led3_threshold: 0.66,
+            led3_gain: 300.0,
+            interval_ms: 500,
+            fast_interval_ms: 20,
+            smoothing: 1.0,
+        }
+    }
+
+    // parse - Applies the settings in text on top of self
+    fn parse(&self, text: &str) -> Result<Config, Error> {
+        let mut config = self.clone();
+
+        for (number, line) in text.lines().enumerate() {
+            let line = line.split('#').next().unwrap_or("").trim();
+            if line.is_empty() {
+                continue;
+            }
+
+            let (key, value) = match line.find('=') {
+                Some(pos) => (line[..pos].trim(), line[pos + 1..].trim()),
+                None => return Err(invalid(format!("line {}: expected key = value", number + 1))),
+            };
+
+            let bad_value = || invalid(format!("line {}: invalid value for {}", number + 1, key));
+            let float = || value.parse::<f64>().map_err(|_| bad_value());
+
+            match key {
+                "device_path" => config.device_path = value.to_string(),
+                "sysfs_path" => config.sysfs_path = value.to_string(),
+                "min_speed" => config.min_speed = float()?,
+                "max_speed" => config.max_speed = float()?,
+                "led1_min" => config.led1_min = float()?,
+                "led2_threshold" => config.led2_threshold = float()?,
+                "led2_gain" => config.led2_gain = float()?,
+                "led3_threshold" => config.led3_threshold = float()?,
+                "led3_gain" => config.led3_gain = float()?,
+                "interval_ms" => config.interval_ms = value.parse::<u64>().map_err(|_| bad_value())?,
+                "fast_interval_ms" => config.fast_interval_ms = value.parse::<u64>().map_err(|_| bad_value())?,
+                "smoothing" => config.smoothing = float()?,
+                _ => return Err(invalid(format!("line {}: unknown key {}", number + 1, key))),
+            }
+        }
+
+        config.validate()?;
+        Ok(config)
+    }
+
+    // validate - Rejects settings the mapping cannot work with
+    fn validate(&self) -> Result<(), Error> {
+        if self.device_path.is_empty() || self.sysfs_path.is_empty() {
+            return Err(invalid("device_path and sysfs_path must not be empty".to_string()));
+        }
+        if !(self.min_speed >= 0.0 && self.min_speed < self.max_speed) {
+            return Err(invalid("min_speed must be below max_speed".to_string()));
+        }
+        if !(0.0..=100.0).contains(&self.led1_min) {
+            return Err(invalid("led1_min must be between 0 and 100".to_string()));
+        }
+        if !(0.0..=1.0).contains(&self.led2_threshold) || !(0.0..=1.0).contains(&self.led3_threshold) {
+            return Err(invalid("thresholds must be between 0 and 1".to_string()));
+        }
+        if !(self.led2_gain >= 0.0 && self.led3_gain >= 0.0) {
+            return Err(invalid("gains must not be negative".to_string()));
+        }
+        if self.interval_ms == 0 {
+            return Err(invalid("interval_ms must be positive".to_string()));
+        }
+        if self.fast_interval_ms == 0 {
+            return Err(invalid("fast_interval_ms must be positive".to_string()));
+        }
+        if !(self.smoothing > 0.0 && self.smoothing <= 1.0) {
+            return Err(invalid("smoothing must be in (0, 1]".to_string()));
+        }
+        Ok(())
+    }
+}
+
+fn invalid(message: String) -> Error {
+    Error::new(ErrorKind::InvalidData, message)
+}
+
+// load - Reads the config file, using defaults for settings it does not set
+pub fn load(file: &str, defaults: &Config) -> Result<Config, Error> {
+    let text = fs::read_to_string(file)?;
+    defaults.parse(&text)
+}
+
+// load_or_defaults - Like load, but falls back to the defaults on any error
+pub fn load_or_defaults(file: &str, defaults: &Config) -> Config {
+    match load(file, defaults) {
+        Ok(config) => config,
+        Err(e) => {
+            if e.kind() != ErrorKind::NotFound {
+                eprintln!("Ignoring config file {}: {}", file, e);
+            }
+            defaults.clone()
+        }
+    }
+}
+
+// reload - Applies config file changes reported by the watcher
+// The new config replaces current only if it parses and check accepts it, so
+// a bad file or an unreachable transport keeps the running config
+
+pub fn reload<F>(watcher: &mut Option<ConfigWatcher>, file: &str, defaults: &Config,
+                 current: &mut Config, check: F) -> bool
+    where F: Fn(&Config) -> Result<(), Error>
+{
+    if !watcher.as_mut().map_or(false, |w| w.changed()) {
+        return false;
+    }
+
+    match load(file, defaults).and_then(|new_config| check(&new_config).map(|_| new_config)) {
+        Ok(new_config) => {
+            if new_config == *current {
+                return false;
+            }
+            println!("Configuration reloaded from {}", file);
+            *current = new_config;
+            true
+        }
+        Err(e) => {
+            eprintln!("Keeping previous configuration: {}", e);
+            false
+        }
+    }
+}
+
+// SpeedSmoother - Exponential smoothing of the speed, independent of the sample rate
+// smoothing is the weight of a sample taken interval_ms after the previous one;
+// the weight is scaled by the measured gap, so faster sampling smooths just as much
+
+pub struct SpeedSmoother {
+    value: Option<f64>,             // Smoothed speed, None before the first sample
+    last_sample: Option<Instant>,   // Time of the previous sample
+}
+
+impl SpeedSmoother {
+    pub fn new() -> SpeedSmoother {
+        SpeedSmoother { value: None, last_sample: None }
+    }
+
+    // update - Adds a speed sample and returns the smoothed speed
+    pub fn update(&mut self, speed: f64, config: &Config) -> f64 {
+        let now = Instant::now();
+        let smoothed = match (self.value, self.last_sample) {
+            (Some(previous), Some(last)) if config.smoothing < 1.0 => {
+                let elapsed_ms = now.duration_since(last).as_secs_f64() * 1000.0;
+                let alpha = 1.0 - (1.0 - config.smoothing).powf(elapsed_ms / config.interval_ms as f64);
+                previous + alpha * (speed - previous)
+            }
+            _ => speed,
+        };
+
+        self.value = Some(smoothed);
+        self.last_sample = Some(now);
+        smoothed
+    }
+
+    // settled - Tells whether the smoothed speed has caught up with speed
+    #[allow(dead_code)]  // Only used by the sysfs client
+    pub fn settled(&self, speed: f64) -> bool {
+        self.value.map_or(false, |value| (value - speed).abs() < SETTLED_SPEED_DELTA)
+    }
+}
+
+// map_speed_to_duty_cycles - Maps button press speed to LED duty cycles
+
+pub fn map_speed_to_duty_cycles(speed: f64, config: &Config) -> (u32, u32, u32) {
+    if speed <= config.min_speed {
+        // Min speed: L1 at led1_min, L2 and L3 off
+        return (config.led1_min as u32, 0, 0);
+    } else if speed >= config.max_speed {
+        // Max speed: All LEDs at max 
+        return (100, 100, 100);
+    } else {
+        // Scale LEDs based on speed
+        let range = config.max_speed - config.min_speed;
+        let position = speed - config.min_speed;
+        let percentage = position / range;
+        
+        // Calculate LED duty cycles:
+        // LED1: scales from led1_min to 100% across the entire range
+        let led1 = (config.led1_min + (100.0 - config.led1_min) * percentage) as u32;
+        
+        // LED2: turns on at led2_threshold of the range, scales to 100%
+        let led2 = if percentage > config.led2_threshold { 
+            ((percentage - config.led2_threshold) * config.led2_gain) as u32 
+        } else { 
+            0 
+        };
+        
+        // LED3: turns on at led3_threshold of the range, scales to 100%
+        let led3 = if percentage > config.led3_threshold { 
+            ((percentage - config.led3_threshold) * config.led3_gain) as u32 
+        } else { 
+            0 
+        };
+        
+        // Ensure we're within bounds (0-100%)
+        let led2 = led2.min(100);
+        let led3 = led3.min(100);
+        
+        return (led1, led2, led3);
+    }
+}
+
+// ConfigWatcher - Reports changes to the config file through inotify
+pub struct ConfigWatcher {
+    events: File,   // Non-blocking inotify descriptor
+    name: Vec<u8>,  // File name of the config file inside the watched directory
+}
+
+impl ConfigWatcher {
+    // new - Watches the directory of file, so editors that replace the file are seen too
+    // Only completed writes and renames are reported, never a file that is still being written
+    pub fn new(file: &str) -> Result<ConfigWatcher, Error> {
+        let path = Path::new(file);
+        let name = match path.file_name() {
+            Some(name) => name.as_bytes().to_vec(),
+            None => return Err(invalid(format!("{} is not a file path", file))),
+        };
+        let dir = match path.parent() {
+            Some(dir) if !dir.as_os_str().is_empty() => dir,
+            _ => Path::new("."),
+        };
+        let dir = CString::new(dir.as_os_str().as_bytes())
+            .map_err(|_| invalid(format!("{} contains a NUL byte", file)))?;
+
+        let fd = unsafe { inotify_init1(IN_NONBLOCK | IN_CLOEXEC) };
+        if fd < 0 {
+            return Err(Error::last_os_error());
+        }
+        // File takes ownership of fd and closes it on drop
+        let events = unsafe { File::from_raw_fd(fd) };
+
+        if unsafe { inotify_add_watch(fd, dir.as_ptr(), IN_CLOSE_WRITE | IN_MOVED_TO) } < 0 {
+            return Err(Error::last_os_error());
+        }
+
+        Ok(ConfigWatcher { events, name })
+    }
+
+    // changed - Drains pending events and returns true if any concerned the config file
+    pub fn changed(&mut self) -> bool {
+        let mut buffer = [0u8; 4096];
+        let mut changed = false;
+
+        loop {
+            let len = match self.events.read(&mut buffer) {
+                Ok(len) if len > 0 => len,
+                _ => break,  // WouldBlock once all events are read
+            };
+
+            let mut offset = 0;
+            while offset + EVENT_HEADER_LEN <= len {
+                let name_len = u32::from_ne_bytes([buffer[offset + 12], buffer[offset + 13],
+                                                   buffer[offset + 14], buffer[offset + 15]]) as usize;
+                let start = offset + EVENT_HEADER_LEN;
+                let end = (start + name_len).min(len);
+
+                // The name is padded with NUL bytes
+                let name = &buffer[start..end];
+                let name = &name[..name.iter().position(|&b| b == 0).unwrap_or(name.len())];
+                if name == self.name.as_slice() {
+                    changed = true;
+                }
+
+                offset = start + name_len;
+            }
+        }
+
+        changed
+    }
+}
@@ -2,42 +2,85 @@
 // and sets LED duty cycles accordingly.
  
 
+mod config;
+mod metrics;
+
 use std::fs::{File, OpenOptions};
 use std::io::{Read, Write, Error};
 use std::thread::sleep;
-use std::time::Duration;
+use std::time::{Duration, Instant};
+
+use config::{Config, ConfigWatcher, SpeedSmoother, map_speed_to_duty_cycles};
+use metrics::Metrics;
 
-// Constants for device path and speed mapping
-const DEVICE_PATH: &str = "/dev/pwm_led_controller";  // Path to character device
-const MAX_SPEED: u64 = 10;  // Max button press speed 
-const MIN_SPEED: u64 = 1;   // Min button press speed 
+// Metrics export
+const DEFAULT_METRICS_PATH: &str = "/var/lib/node_exporter/textfile_collector/pwm_led_device_driver.prom";
+const METRICS_INTERVAL: Duration = Duration::from_secs(10);  // Time between two exports
 
 fn main() -> Result<(), Error> {
     println!("Project LED Controller - Device Driver Interface");
     println!("Press Ctrl+C to exit");
     
+    let options = config::parse_args(DEFAULT_METRICS_PATH);
+    let mut metrics = Metrics::new("device_driver", options.metrics_path, METRICS_INTERVAL);
+    
+    // Watch the config before loading it, so edits made in between are not missed
+    let channels = config::led_channel_count();
+    let defaults = Config::new();
+    let mut watcher = match ConfigWatcher::new(&options.config_path) {
+        Ok(watcher) => Some(watcher),
+        Err(e) => {
+            eprintln!("Config changes will not be applied until restart: {}", e);
+            None
+        }
+    };
+    let mut config = config::load_or_defaults(&options.config_path, &defaults);
+    let mut smoother = SpeedSmoother::new();
+    
     // Main loop
     loop {
+        // Apply config changes between two cycles, only if the new device path can be read
+        if config::reload(&mut watcher, &options.config_path, &defaults, &mut config,
+                          |new_config| read_speed(&new_config.device_path).map(|_| ())
+                              .map_err(|e| Error::new(e.kind(), format!("{}: {}", new_config.device_path, e)))) {
+            metrics.config_reloads += 1;
+        }
+        
         // Read current button press speed from device
-        let speed = read_speed()?;
-        println!("Current button press speed: {} presses/second", speed);
+        let start = Instant::now();
+        let speed = read_speed(&config.device_path)?;
+        metrics.read_latency.record(start.elapsed());
+        metrics.record_speed(speed);
+        if options.verbose {
+            println!("Current button press speed: {} presses/second", speed);
+        }
+        
+        // Smooth the speed, the state survives config reloads
+        let smoothed = smoother.update(speed as f64, &config);
         
         // Map speed to LED duty cycles
-        let (led1, led2, led3) = map_speed_to_duty_cycles(speed);
-        println!("Setting LED duty cycles: L1={}%, L2={}%, L3={}%", led1, led2, led3);
+        let (led1, led2, led3) = map_speed_to_duty_cycles(smoothed, &config);
+        if options.verbose {
+            println!("Setting LED duty cycles: L1={}%, L2={}%, L3={}%", led1, led2, led3);
+        }
         
         // Update LED duty cycles
-        set_led_duty_cycles(led1, led2, led3)?;
+        let write_start = Instant::now();
+        set_led_duty_cycles(&config.device_path, channels, led1, led2, led3)?;
+        metrics.write_latency.record(write_start.elapsed());
+        metrics.loop_time.record(start.elapsed());
+        
+        metrics.maybe_export();
         
         // Wait before refreshing
-        sleep(Duration::from_millis(500));
+        sleep(Duration::from_millis(config.interval_ms));
     }
 }
 
 //read_speed - Reads the current button press speed from the device
-fn read_speed() -> Result<u64, Error> {
+fn read_speed(path: &str) -> Result<u64, Error> {
     // Open device file for reading
-    let mut file = File::open(DEVICE_PATH)?;
+    let mut file = File::open(path)?;
     let mut buffer = String::new();
     
     // Read device output
@@ -56,55 +99,18 @@ fn read_speed() -> Result<u64, Error> {
 
 //set_led_duty_cycles - Sets LED duty cycles through device driver
 
-fn set_led_duty_cycles(led1: u32, led2: u32, led3: u32) -> Result<(), Error> {
+fn set_led_duty_cycles(path: &str, channels: usize, led1: u32, led2: u32, led3: u32) -> Result<(), Error> {
     // Open device file for writing
-    let mut file = OpenOptions::new().write(true).open(DEVICE_PATH)?;
+    let mut file = OpenOptions::new().write(true).open(path)?;
     
-    // Format command string with the three duty cycle values
-    let command = format!("{} {} {}", led1, led2, led3);
+    // Format command string with one duty cycle per channel, channels beyond LED3 stay off
+    let duties = [led1, led2, led3];
+    let command = (0..channels)
+        .map(|i| duties.get(i).copied().unwrap_or(0).to_string())
+        .collect::<Vec<String>>()
+        .join(" ");
     
     // Write command to device file
     file.write_all(command.as_bytes())?;
     Ok(())
 }
-
-// map_speed_to_duty_cycles - Maps button press speed to LED duty cycles
-
-fn map_speed_to_duty_cycles(speed: u64) -> (u32, u32, u32) {
-    if speed <= MIN_SPEED {
-        // Min speed: L1 at 10%, L2 and L3 off
-        return (10, 0, 0);
-    } else if speed >= MAX_SPEED {
-        // Max speed: All LEDs at max 
-        return (100, 100, 100);
-    } else {
-        // Scale LEDs based on speed
-        let range = MAX_SPEED - MIN_SPEED;
-        let position = speed - MIN_SPEED;
-        let percentage = (position as f64) / (range as f64);
-        
-        // Calculate LED duty cycles:
-        // LED1: scales from 10% to 100% across the entire range
-        let led1 = 10 + (90.0 * percentage) as u32;
-        
-        // LED2: turns on at 33% of the range, scales to 100%
-        let led2 = if percentage > 0.33 { 
-            ((percentage - 0.33) * 150.0) as u32 
-        } else { 
-            0 
-        };
-        
-        // LED3: turns on at 66% of the range, scales to 100%
-        let led3 = if percentage > 0.66 { 
-            ((percentage - 0.66) * 300.0) as u32 
-        } else { 
-            0 
-        };
-        
-        // Ensure we're within bounds (0-100%)
-        let led2 = led2.min(100);
-        let led3 = led3.min(100);
-        
-        return (led1, led2, led3);
-    }
-}
\ No newline at end of file
@@ -0,0 +1,204 @@
+// Metrics shared by the Rust applications.
+// Keeps counters and latency histograms in memory and periodically writes
+// them to a Prometheus textfile collector file.
+
+use std::fmt::Write as FmtWrite;
+use std::fs::{self, File};
+use std::io::{Error, Write};
+use std::time::{Duration, Instant};
+
+// Histogram precision: 16 buckets per power of two (at most about 6% error)
+const SUB_BITS: u32 = 5;
+const SUB_COUNT: usize = 1 << SUB_BITS;
+const HALF_COUNT: usize = SUB_COUNT / 2;
+const BUCKET_COUNT: usize = (64 - SUB_BITS as usize + 1) * HALF_COUNT + HALF_COUNT;
+
+// Quantiles reported for every histogram
+const QUANTILES: [f64; 4] = [0.5, 0.9, 0.99, 0.999];
+
+// Histogram - HDR style log-linear histogram of microsecond values
+pub struct Histogram {
+    buckets: Vec<u64>,  // Counts since the last export
+    count: u64,         // Total number of samples
+    sum: u64,           // Sum of all samples in microseconds
+}
+
+impl Histogram {
+    pub fn new() -> Histogram {
+        Histogram { buckets: vec![0; BUCKET_COUNT], count: 0, sum: 0 }
+    }
+
+    // record - Adds one duration to the histogram
+    pub fn record(&mut self, duration: Duration) {
+        let value = duration.as_micros().min(u64::MAX as u128) as u64;
+        self.buckets[bucket_index(value)] += 1;
+        self.count += 1;
+        self.sum = self.sum.saturating_add(value);
+    }
+
+    // quantile - Returns the upper bound of the bucket holding quantile q
+    // None when the window has no samples
+    fn quantile(&self, q: f64) -> Option<u64> {
+        let total: u64 = self.buckets.iter().sum();
+        if total == 0 {
+            return None;
+        }
+
+        let rank = ((total as f64) * q).ceil().max(1.0) as u64;
+        let mut seen = 0;
+        for (index, count) in self.buckets.iter().enumerate() {
+            seen += count;
+            if seen >= rank {
+                return Some(bucket_upper_bound(index));
+            }
+        }
+        None
+    }
+
+    // reset_window - Clears the buckets so quantiles cover one export interval
+    fn reset_window(&mut self) {
+        for bucket in self.buckets.iter_mut() {
+            *bucket = 0;
+        }
+    }
+}
+
+// bucket_index - Maps a value to its bucket, exact below SUB_COUNT
+fn bucket_index(value: u64) -> usize {
+    if value < SUB_COUNT as u64 {
+        return value as usize;
+    }
+    let exponent = (63 - value.leading_zeros()) - (SUB_BITS - 1);
+    exponent as usize * HALF_COUNT + (value >> exponent) as usize
+}
+
+// bucket_upper_bound - Returns the largest value stored in a bucket
+fn bucket_upper_bound(index: usize) -> u64 {
+    if index < SUB_COUNT {
+        return index as u64;
+    }
+    let exponent = (index / HALF_COUNT - 1) as u32;
+    let sub = (index - exponent as usize * HALF_COUNT) as u64;
+    ((sub + 1) << exponent).wrapping_sub(1)
+}
+
+// Metrics - Counters and histograms for one application
+pub struct Metrics {
+    interface: &'static str,        // Value of the interface label
+    path: String,                   // Textfile collector output file
+    interval: Duration,             // Time between two exports
+    last_export: Instant,           // Time of the last export
+    export_failed: bool,            // Set once an export failed, to log only once
+    pub iterations: u64,            // Completed main loop iterations
+    pub speed_changes: u64,         // Iterations where the speed changed
+    pub config_reloads: u64,        // Config changes applied without restart
+    pub speed: u64,                 // Last button press speed
+    pub loop_time: Histogram,       // Work per iteration, excluding the sleep
+    pub read_latency: Histogram,    // Time to read the speed
+    pub write_latency: Histogram,   // Time to write the duty cycles
+}
+
+impl Metrics {
+    pub fn new(interface: &'static str, path: String, interval: Duration) -> Metrics {
+        Metrics {
+            interface,
+            path,
+            interval,
+            last_export: Instant::now(),
+            export_failed: false,
+            iterations: 0,
+            speed_changes: 0,
+            config_reloads: 0,
+            speed: 0,
+            loop_time: Histogram::new(),
+            read_latency: Histogram::new(),
+            write_latency: Histogram::new(),
+        }
+    }
+
+    // record_speed - Stores the latest speed and counts changes
+    pub fn record_speed(&mut self, speed: u64) {
+        if self.iterations > 0 && speed != self.speed {
+            self.speed_changes += 1;
+        }
+        self.speed = speed;
+        self.iterations += 1;
+    }
+
+    // maybe_export - Writes the metrics file once the export interval has passed
+    pub fn maybe_export(&mut self) {
+        if self.last_export.elapsed() < self.interval {
+            return;
+        }
+        self.last_export = Instant::now();
+
+        if let Err(e) = self.export() {
+            if !self.export_failed {
+                eprintln!("Failed to write metrics to {}: {}", self.path, e);
+                self.export_failed = true;
+            }
+        }
+
+        self.loop_time.reset_window();
+        self.read_latency.reset_window();
+        self.write_latency.reset_window();
+    }
+
+    // export - Atomically replaces the metrics file with the current values
+    fn export(&self) -> Result<(), Error> {
+        let text = self.render();
+        let tmp_path = format!("{}.tmp", self.path);
+
+        // Write to a temporary file and rename it so the collector never sees a partial file
+        let mut file = File::create(&tmp_path)?;
+        file.write_all(text.as_bytes())?;
+        fs::rename(&tmp_path, &self.path)
+    }
+
+    // render - Formats all metrics in the Prometheus text format
+    fn render(&self) -> String {
+        let mut out = String::new();
+        let label = format!("interface=\"{}\"", self.interface);
+
+        let _ = writeln!(out, "# HELP pwm_led_client_iterations_total Completed main loop iterations.");
+        let _ = writeln!(out, "# TYPE pwm_led_client_iterations_total counter");
+        let _ = writeln!(out, "pwm_led_client_iterations_total{{{}}} {}", label, self.iterations);
+
+        let _ = writeln!(out, "# HELP pwm_led_client_speed_changes_total Iterations where the button press speed changed.");
+        let _ = writeln!(out, "# TYPE pwm_led_client_speed_changes_total counter");
+        let _ = writeln!(out, "pwm_led_client_speed_changes_total{{{}}} {}", label, self.speed_changes);
+
+        let _ = writeln!(out, "# HELP pwm_led_client_config_reloads_total Config changes applied without restart.");
+        let _ = writeln!(out, "# TYPE pwm_led_client_config_reloads_total counter");
+        let _ = writeln!(out, "pwm_led_client_config_reloads_total{{{}}} {}", label, self.config_reloads);
+
+        let _ = writeln!(out, "# HELP pwm_led_client_speed Last button press speed in presses per second.");
+        let _ = writeln!(out, "# TYPE pwm_led_client_speed gauge");
+        let _ = writeln!(out, "pwm_led_client_speed{{{}}} {}", label, self.speed);
+
+        render_summary(&mut out, &label, "pwm_led_client_loop_seconds",
+                       "Work per main loop iteration, excluding the sleep.", &self.loop_time);
+        render_summary(&mut out, &label, "pwm_led_client_read_latency_seconds",
+                       "Time to read the button press speed.", &self.read_latency);
+        render_summary(&mut out, &label, "pwm_led_client_write_latency_seconds",
+                       "Time to write the LED duty cycles.", &self.write_latency);
+
+        out
+    }
+}
+
+// render_summary - Formats a histogram as a summary with quantiles in seconds
+// Quantiles of a window without samples are NaN, like Prometheus client summaries
+fn render_summary(out: &mut String, label: &str, name: &str, help: &str, histogram: &Histogram) {
+    let _ = writeln!(out, "# HELP {} {}", name, help);
+    let _ = writeln!(out, "# TYPE {} summary", name);
+    for q in QUANTILES.iter() {
+        let value = match histogram.quantile(*q) {
+            Some(micros) => format!("{:.6}", micros as f64 / 1e6),
+            None => "NaN".to_string(),
+        };
+        let _ = writeln!(out, "{}{{{},quantile=\"{}\"}} {}", name, label, q, value);
+    }
+    let _ = writeln!(out, "{}_sum{{{}}} {:.6}", name, label, histogram.sum as f64 / 1e6);
+    let _ = writeln!(out, "{}_count{{{}}} {}", name, label, histogram.count);
+}
@@ -27,6 +27,7 @@
 #include <linux/interrupt.h>   /* For interrupt handling */
 #include <linux/sysfs.h>       
 #include <linux/kobject.h>     
+#include <linux/spinlock.h>    /* For encoder state locking */
 
 /* Module parameters and constants */
 #define DEVICE_NAME "pwm_led_controller"   // Name of device in /dev
@@ -40,22 +41,33 @@
 #define LED3_PIN 22  // GPIO pin for LED3 
 #define BTN1_PIN 23  // GPIO pin for button 1 
 #define BTN2_PIN 24  // GPIO pin for button 2 
+#define ENC_A_PIN 25 // Default GPIO pin for encoder channel A 
+#define ENC_B_PIN 26 // Default GPIO pin for encoder channel B 
+#define MAX_LEDS 32  // Max number of LED channels 
 
 /* PWM Parameters */
 #define PWM_PERIOD_NS 10000000  // 10ms in nanoseconds 
 #define MIN_DUTY 0              // 0% duty cycle 
 #define MAX_DUTY 100            // 100% duty cycle 
 
+/* Encoder Parameters */
+#define ENC_COUNTS_PER_DETENT 4 // Quadrature transitions per detent 
+#define ENC_IDLE_NS 1000000000  // Velocity drops to 0 after 1s without a detent 
+
 // global variables 
 static int major;                   // number assigned to device 
 static struct class *projectClass = NULL;    // Device class 
 static struct device *projectDevice = NULL;  // Device structure 
 static struct kobject *project_kobj;         // Kobject for sysfs entries 
 
+// LED channels, overridable at load time (e.g. led_pins=17,27,22,5) 
+static int led_pins[MAX_LEDS] = { LED1_PIN, LED2_PIN, LED3_PIN };
+static int num_leds = 3;
+module_param_array(led_pins, int, &num_leds, 0444);
+MODULE_PARM_DESC(led_pins, "GPIO pins of the LED channels (default 17,27,22)");
+
 // LED PWM duty cycles (percentage 0-100) 
-static int led1_duty = 0; 
-static int led2_duty = 0; 
-static int led3_duty = 0; 
+static int led_duty[MAX_LEDS];
 
 // Button press timing
 static ktime_t last_press_time;         // Time of last button press 
@@ -66,6 +78,35 @@ static int valid_alternating_count = 0; // Number of valid alternating presses
 static u64 total_press_time = 0;        // Sum of intervals between alternating presses 
 static u64 avg_press_interval = 0;      // Average interval in nanoseconds 
 
+// Input mode, buttons by default 
+static bool encoder_mode = false;
+module_param(encoder_mode, bool, 0444);
+MODULE_PARM_DESC(encoder_mode, "Use a quadrature encoder instead of the buttons");
+
+// Encoder pins, overridable at load time (e.g. enc_a_pin=12 enc_b_pin=13) 
+static int enc_a_pin = ENC_A_PIN;
+static int enc_b_pin = ENC_B_PIN;
+module_param(enc_a_pin, int, 0444);
+MODULE_PARM_DESC(enc_a_pin, "GPIO pin of encoder channel A (default 25)");
+module_param(enc_b_pin, int, 0444);
+MODULE_PARM_DESC(enc_b_pin, "GPIO pin of encoder channel B (default 26)");
+
+// Quadrature encoder 
+static DEFINE_SPINLOCK(encoder_lock);  // Serializes the A and B interrupts 
+static int encoder_state = 0;          // Last A/B state (A << 1 | B) 
+static int encoder_counts = 0;         // Transitions since last detent 
+static long encoder_position = 0;      // Position in transitions 
+static int encoder_direction = 0;      // Direction of last detent (1 = CW, -1 = CCW) 
+static u64 encoder_interval = 0;       // Time between the last two detents 
+
+// Step for each (previous state << 2 | current state), 0 for no or invalid change 
+static const s8 encoder_table[16] = {
+     0, -1,  1,  0,
+     1,  0,  0, -1,
+    -1,  0,  0,  1,
+     0,  1, -1,  0,
+};
+
 // for PWM control 
 static struct hrtimer pwm_timer;    // High-resolution timer for PWM
 static int pwm_state = 1;           // LED state (1=ON, 0=OFF) 
@@ -88,6 +129,8 @@ static ssize_t led2_duty_store(struct kobject *kobj, struct kobj_attribute *attr
 static ssize_t led3_duty_show(struct kobject *kobj, struct kobj_attribute *attr, char *buf);
 static ssize_t led3_duty_store(struct kobject *kobj, struct kobj_attribute *attr, const char *buf, size_t count);
 static ssize_t button_speed_show(struct kobject *kobj, struct kobj_attribute *attr, char *buf);
+static ssize_t encoder_position_show(struct kobject *kobj, struct kobj_attribute *attr, char *buf);
+static ssize_t encoder_velocity_show(struct kobject *kobj, struct kobj_attribute *attr, char *buf);
 
 //file operations for device driver 
 static struct file_operations project_fops = {
@@ -106,6 +149,10 @@ static struct kobj_attribute led3_attribute =
     __ATTR(led3_duty, 0664, led3_duty_show, led3_duty_store);  // LED3 duty cycle 
 static struct kobj_attribute speed_attribute = 
     __ATTR(button_speed, 0444, button_speed_show, NULL);       // Button speed 
+static struct kobj_attribute position_attribute = 
+    __ATTR(encoder_position, 0444, encoder_position_show, NULL);  // Encoder position 
+static struct kobj_attribute velocity_attribute = 
+    __ATTR(encoder_velocity, 0444, encoder_velocity_show, NULL);  // Encoder velocity 
 
 // Grouping everything for sysfs 
 static struct attribute *attrs[] = {
@@ -113,27 +160,92 @@ static struct attribute *attrs[] = {
     &led2_attribute.attr,    // LED2 duty cycle 
     &led3_attribute.attr,    // LED3 duty cycle 
     &speed_attribute.attr,   // Button press speed 
+    &position_attribute.attr,   // Encoder position 
+    &velocity_attribute.attr,   // Encoder velocity 
     NULL,                    
 };
 
+// led_attr_is_visible - Hides the duty cycle attributes of LEDs beyond num_leds 
+// and the encoder attributes in button mode 
+static umode_t led_attr_is_visible(struct kobject *kobj, struct attribute *attr, int n) {
+    if ((attr == &led2_attribute.attr && num_leds < 2) ||
+        (attr == &led3_attribute.attr && num_leds < 3))
+        return 0;
+    if (!encoder_mode &&
+        (attr == &position_attribute.attr || attr == &velocity_attribute.attr))
+        return 0;
+    return attr->mode;
+}
+
 static struct attribute_group attr_group = {
     .attrs = attrs,
+    .is_visible = led_attr_is_visible,
 };
 
 /*
- * update_leds function Updates LED states based on current PWM state and duty cycles
+ * PWM engine - per edge LED update and max duty scan
+ *
+ * The timer callback runs twice per PWM period, so both routines are generated
+ * for the common channel counts with a constant trip count. update_leds() and
+ * find_max_duty() switch on num_leds to direct calls, so the hrtimer path has
+ * no indirect call; other counts fall back to the generic loop over num_leds.
+ * GCC fully unrolls the small counts at -O2, the 16 and 32 channel versions
+ * may stay loops but keep a constant bound.
  */
+#define PWM_ENGINE_COUNTS(X) X(1) X(3) X(4) X(8) X(16) X(32)
+
+#define DEFINE_PWM_ENGINE(name, n)                                      \
+static void update_leds_##name(void) {                                 \
+    int i;                                                              \
+    if (pwm_state) {                                                    \
+        /* LEDs ON state (according to duty cycle) */                   \
+        for (i = 0; i < (n); i++)                                       \
+            if (led_duty[i] > 0) gpio_set_value(led_pins[i], 1);        \
+    } else {                                                            \
+        /* LEDs OFF state */                                            \
+        for (i = 0; i < (n); i++)                                       \
+            if (led_duty[i] < 100) gpio_set_value(led_pins[i], 0);      \
+    }                                                                   \
+}                                                                       \
+static int max_duty_##name(void) {                                     \
+    int i;                                                              \
+    int max_duty = led_duty[0];                                         \
+    for (i = 1; i < (n); i++)                                           \
+        if (led_duty[i] > max_duty) max_duty = led_duty[i];             \
+    return max_duty;                                                    \
+}
+
+#define DEFINE_FIXED_PWM_ENGINE(n) DEFINE_PWM_ENGINE(n, n)
+#define UPDATE_LEDS_CASE(n) case n: update_leds_##n(); break;
+#define MAX_DUTY_CASE(n) case n: return max_duty_##n();
+#define SPECIALIZED_CASE(n) case n:
+
+PWM_ENGINE_COUNTS(DEFINE_FIXED_PWM_ENGINE)
+DEFINE_PWM_ENGINE(generic, num_leds)
+
+// update_leds function updates LED states based on current PWM state and duty cycles
 static void update_leds(void) {
-    if (pwm_state) {
-        // LEDs ON state (according to duty cycle) 
-        if (led1_duty > 0) gpio_set_value(LED1_PIN, 1);  
-        if (led2_duty > 0) gpio_set_value(LED2_PIN, 1);  
-        if (led3_duty > 0) gpio_set_value(LED3_PIN, 1);  
-    } else {
-        // LEDs OFF state
-        if (led1_duty < 100) gpio_set_value(LED1_PIN, 0); 
-        if (led2_duty < 100) gpio_set_value(LED2_PIN, 0); 
-        if (led3_duty < 100) gpio_set_value(LED3_PIN, 0); 
+    switch (num_leds) {
+    PWM_ENGINE_COUNTS(UPDATE_LEDS_CASE)
+    default: update_leds_generic(); break;
+    }
+}
+
+// find_max_duty function returns the highest duty cycle of all channels
+static int find_max_duty(void) {
+    switch (num_leds) {
+    PWM_ENGINE_COUNTS(MAX_DUTY_CASE)
+    default: return max_duty_generic();
+    }
+}
+
+// pwm_engine_specialized function tells whether num_leds has a generated engine
+static bool pwm_engine_specialized(void) {
+    switch (num_leds) {
+    PWM_ENGINE_COUNTS(SPECIALIZED_CASE)
+        return true;
+    default:
+        return false;
     }
 }
 
@@ -144,9 +256,7 @@ static void calculate_pwm_timing(void) {
     u64 on_time_ns;                 // ON time duration 
     
     // Get the maximum duty cycle for timing calculation
-    int max_duty = led1_duty;
-    if (led2_duty > max_duty) max_duty = led2_duty;
-    if (led3_duty > max_duty) max_duty = led3_duty;
+    int max_duty = find_max_duty();
     
     // Calculate max duty cycle (if all LEDs are at 0%, keep a minimum time)
     on_time_ns = max_duty ? period_ns : 1;
@@ -186,6 +296,27 @@ static enum hrtimer_restart pwm_timer_callback(struct hrtimer *timer) {
     return HRTIMER_RESTART;  // Keep the timer running 
 }
 
+ // update_press_average - Feeds one input interval into the speed estimator
+ // Shared by the button handlers and the encoder handler
+
+static void update_press_average(u64 interval_ns) {
+    total_press_time += interval_ns;
+    valid_alternating_count++;
+    
+    // Calculate average over last 10 seconds
+    if (valid_alternating_count > 0) {
+        do_div(total_press_time, valid_alternating_count);
+        avg_press_interval = total_press_time;
+        total_press_time = avg_press_interval * valid_alternating_count; 
+    }
+    
+    // Reset counters to avoid overflow 
+    if (valid_alternating_count > 100) {
+        total_press_time = avg_press_interval * 20; // weighted average
+        valid_alternating_count = 20;
+    }
+}
+
  // button1_handler - Interrupt handler for Button 1
  // Processes Button 1 presses and calculates timing if alternating with Button 2
 
@@ -193,24 +324,8 @@ static irqreturn_t button1_handler(int irq, void *dev_id) {
     current_press_time = ktime_get();  /* Record the current time */
     
     
-    if (last_button == 2) {  
-        u64 interval_ns = ktime_to_ns(ktime_sub(current_press_time, last_press_time));
-        total_press_time += interval_ns;
-        valid_alternating_count++;
-        
-        // Calculate average over last 10 seconds
-        if (valid_alternating_count > 0) {
-            do_div(total_press_time, valid_alternating_count);
-            avg_press_interval = total_press_time;
-            total_press_time = avg_press_interval * valid_alternating_count; 
-        }
-        
-        // Reset counters to avoid overflow 
-        if (valid_alternating_count > 100) {
-            total_press_time = avg_press_interval * 20; // weighted average
-            valid_alternating_count = 20;
-        }
-    }
+    if (last_button == 2)
+        update_press_average(ktime_to_ns(ktime_sub(current_press_time, last_press_time)));
     
     last_button = 1;  
     last_press_time = current_press_time;
@@ -226,24 +341,8 @@ static irqreturn_t button2_handler(int irq, void *dev_id) {
     current_press_time = ktime_get(); 
     
     
-    if (last_button == 1) {  
-        u64 interval_ns = ktime_to_ns(ktime_sub(current_press_time, last_press_time));
-        total_press_time += interval_ns;
-        valid_alternating_count++;
-        
-        // Calculate average over last 10 seconds
-        if (valid_alternating_count > 0) {
-            do_div(total_press_time, valid_alternating_count);
-            avg_press_interval = total_press_time;
-            total_press_time = avg_press_interval * valid_alternating_count; 
-        }
-        
-        // Reset counters if to avoid overflow 
-        if (valid_alternating_count > 100) {
-            total_press_time = avg_press_interval * 20; // average 
-            valid_alternating_count = 20;
-        }
-    }
+    if (last_button == 1)
+        update_press_average(ktime_to_ns(ktime_sub(current_press_time, last_press_time)));
     
     last_button = 2;  
     last_press_time = current_press_time;
@@ -252,10 +351,49 @@ static irqreturn_t button2_handler(int irq, void *dev_id) {
     return IRQ_HANDLED;
 }
 
+ // encoder_handler - Interrupt handler for both encoder channels
+ // Decodes the A/B quadrature state, tracks position and feeds every full
+ // detent into the speed estimator like an alternating button press.
+ // The estimator is unsigned, so both directions raise the speed the same way;
+ // direction and position are only exported through sysfs
+
+static irqreturn_t encoder_handler(int irq, void *dev_id) {
+    unsigned long flags;
+    int state;
+    int step;
+    
+    spin_lock_irqsave(&encoder_lock, flags);
+    
+    state = (gpio_get_value(enc_a_pin) << 1) | gpio_get_value(enc_b_pin);
+    step = encoder_table[(encoder_state << 2) | state];
+    encoder_state = state;
+    
+    if (step) {
+        encoder_position += step;
+        encoder_counts += step;
+        
+        // One detent per full quadrature cycle 
+        if (abs(encoder_counts) >= ENC_COUNTS_PER_DETENT) {
+            current_press_time = ktime_get();
+            encoder_interval = ktime_to_ns(ktime_sub(current_press_time, last_press_time));
+            encoder_direction = encoder_counts > 0 ? 1 : -1;
+            encoder_counts = 0;
+            
+            update_press_average(encoder_interval);
+            last_press_time = current_press_time;
+            button_press_count++;
+        }
+    }
+    
+    spin_unlock_irqrestore(&encoder_lock, flags);
+    
+    return IRQ_HANDLED;
+}
+
 // led1_duty_show - Sysfs show function for LED1 duty cycle
  
 static ssize_t led1_duty_show(struct kobject *kobj, struct kobj_attribute *attr, char *buf) {
-    return sprintf(buf, "%d\n", led1_duty);  // Returns duty cycle
+    return sprintf(buf, "%d\n", led_duty[0]);  // Returns duty cycle
 }
 
  //led1_duty_store - Sysfs store function for LED1 duty cycle
@@ -274,7 +412,7 @@ static ssize_t led1_duty_store(struct kobject *kobj, struct kobj_attribute *attr
     if (duty < MIN_DUTY || duty > MAX_DUTY)
         return -EINVAL;
     
-    led1_duty = duty;  
+    led_duty[0] = duty;  
     calculate_pwm_timing();   
     
     return count;
@@ -282,7 +420,7 @@ static ssize_t led1_duty_store(struct kobject *kobj, struct kobj_attribute *attr
 
  //led2_duty_show - Sysfs show function for LED2 duty cycle
 static ssize_t led2_duty_show(struct kobject *kobj, struct kobj_attribute *attr, char *buf) {
-    return sprintf(buf, "%d\n", led2_duty); 
+    return sprintf(buf, "%d\n", led_duty[1]); 
 }
 
  //led2_duty_store - Sysfs store function for LED2 duty cycle
@@ -301,7 +439,7 @@ static ssize_t led2_duty_store(struct kobject *kobj, struct kobj_attribute *attr
     if (duty < MIN_DUTY || duty > MAX_DUTY)
         return -EINVAL;
     
-    led2_duty = duty;  
+    led_duty[1] = duty;  
     calculate_pwm_timing();  
     
     return count;
@@ -310,7 +448,7 @@ static ssize_t led2_duty_store(struct kobject *kobj, struct kobj_attribute *attr
  //led3_duty_show - Sysfs show function for LED3 duty cycle
 
 static ssize_t led3_duty_show(struct kobject *kobj, struct kobj_attribute *attr, char *buf) {
-    return sprintf(buf, "%d\n", led3_duty);  /* Return current duty cycle */
+    return sprintf(buf, "%d\n", led_duty[2]);  /* Return current duty cycle */
 }
 
  //led3_duty_store - Sysfs store function for LED3 duty cycle
@@ -329,7 +467,7 @@ static ssize_t led3_duty_store(struct kobject *kobj, struct kobj_attribute *attr
     if (duty < MIN_DUTY || duty > MAX_DUTY)
         return -EINVAL;
     
-    led3_duty = duty;  
+    led_duty[2] = duty;  
     calculate_pwm_timing();  
     
     return count;
@@ -349,6 +487,38 @@ static ssize_t button_speed_show(struct kobject *kobj, struct kobj_attribute *at
     return sprintf(buf, "%llu\n", speed);
 }
 
+ //encoder_position_show - Sysfs show function for encoder position in transitions
+
+static ssize_t encoder_position_show(struct kobject *kobj, struct kobj_attribute *attr, char *buf) {
+    return sprintf(buf, "%ld\n", encoder_position);
+}
+
+ //encoder_velocity_show - Sysfs show function for encoder velocity
+ //Signed detents per second, based on the time between the last two detents
+
+static ssize_t encoder_velocity_show(struct kobject *kobj, struct kobj_attribute *attr, char *buf) {
+    unsigned long flags;
+    ktime_t now = ktime_get();
+    ktime_t last_detent;
+    u64 interval;
+    int direction;
+    u64 speed = 0;
+    
+    // 64-bit values can tear on 32-bit platforms, so copy them under the lock 
+    spin_lock_irqsave(&encoder_lock, flags);
+    last_detent = last_press_time;
+    interval = encoder_interval;
+    direction = encoder_direction;
+    spin_unlock_irqrestore(&encoder_lock, flags);
+    
+    if (interval > 0 && ktime_to_ns(ktime_sub(now, last_detent)) < ENC_IDLE_NS) {
+        speed = 1000000000ULL;
+        do_div(speed, interval);
+    }
+    
+    return sprintf(buf, "%lld\n", direction * (s64)speed);
+}
+
  //device_open - Called when the device is opened
  // Prepares the device for reading
  
@@ -398,11 +568,14 @@ static ssize_t device_read(struct file *filp, char __user *buffer, size_t length
  // Returns: Number of bytes written
 
 static ssize_t device_write(struct file *filp, const char __user *buffer, size_t length, loff_t *offset) {
-    char input[20];
-    int led1, led2, led3;
+    char input[MAX_LEDS * 4 + 1];   // Up to "100 " per channel 
+    char *cur = input;
+    char *tok;
+    int duty[MAX_LEDS];
+    int count = 0;
     
     
-    if (length > 19)
+    if (length > sizeof(input) - 1)
         return -EINVAL;
     
     
@@ -411,24 +584,129 @@ static ssize_t device_write(struct file *filp, const char __user *buffer, size_t
     
     input[length] = '\0';  
     
+    // Expects one duty cycle per channel, e.g. "10 50 100" 
+    while ((tok = strsep(&cur, " \n")) != NULL) {
+        if (*tok == '\0')
+            continue;
+        if (count == num_leds || kstrtoint(tok, 10, &duty[count]))
+            return -EINVAL;
+        if (duty[count] < MIN_DUTY || duty[count] > MAX_DUTY)
+            return -EINVAL;
+        count++;
+    }
     
-    if (sscanf(input, "%d %d %d", &led1, &led2, &led3) == 3) {
-        
-        if (led1 >= MIN_DUTY && led1 <= MAX_DUTY &&
-            led2 >= MIN_DUTY && led2 <= MAX_DUTY &&
-            led3 >= MIN_DUTY && led3 <= MAX_DUTY) {
-            
-            
-            led1_duty = led1;
-            led2_duty = led2;
-            led3_duty = led3;
-            calculate_pwm_timing();  
-            
-            return length;
-        }
+    if (count != num_leds)
+        return -EINVAL; 
+    
+    memcpy(led_duty, duty, count * sizeof(int));
+    calculate_pwm_timing();  
+    
+    return length;
+}
+
+ // setup_buttons - Requests the button GPIOs and their interrupts
+
+static int setup_buttons(void) {
+    int ret;
+    int button1_irq, button2_irq;
+    
+    ret = gpio_request(BTN1_PIN, "BUTTON1");
+    if (ret) {
+        pr_alert("Failed to request BUTTON1 GPIO\n");
+        return ret;
+    }
+    ret = gpio_request(BTN2_PIN, "BUTTON2");
+    if (ret) {
+        pr_alert("Failed to request BUTTON2 GPIO\n");
+        goto fail_btn2;
     }
     
-    return -EINVAL; 
+    gpio_direction_input(BTN1_PIN);      
+    gpio_direction_input(BTN2_PIN);
+    
+    // Sets up button interrupts 
+    button1_irq = gpio_to_irq(BTN1_PIN);
+    button2_irq = gpio_to_irq(BTN2_PIN);
+    
+    ret = request_irq(button1_irq, button1_handler, IRQF_TRIGGER_RISING, "button1_handler", NULL);
+    if (ret) {
+        pr_alert("Failed to request Button1 IRQ\n");
+        goto fail_irq;
+    }
+    
+    ret = request_irq(button2_irq, button2_handler, IRQF_TRIGGER_RISING, "button2_handler", NULL);
+    if (ret) {
+        pr_alert("Failed to request Button2 IRQ\n");
+        free_irq(button1_irq, NULL);
+        goto fail_irq;
+    }
+    
+    return 0;
+    
+fail_irq:
+    gpio_free(BTN2_PIN);
+fail_btn2:
+    gpio_free(BTN1_PIN);
+    return ret;
+}
+
+ // setup_encoder - Requests the encoder GPIOs and their interrupts
+ // Both channels trigger on both edges and share encoder_handler
+
+static int setup_encoder(void) {
+    int ret;
+    int enc_a_irq, enc_b_irq;
+    
+    ret = gpio_request(enc_a_pin, "ENCODER_A");
+    if (ret) {
+        pr_alert("Failed to request ENCODER_A GPIO\n");
+        return ret;
+    }
+    ret = gpio_request(enc_b_pin, "ENCODER_B");
+    if (ret) {
+        pr_alert("Failed to request ENCODER_B GPIO\n");
+        goto fail_enc_b;
+    }
+    
+    gpio_direction_input(enc_a_pin);
+    gpio_direction_input(enc_b_pin);
+    encoder_state = (gpio_get_value(enc_a_pin) << 1) | gpio_get_value(enc_b_pin);
+    
+    // Sets up encoder interrupts 
+    enc_a_irq = gpio_to_irq(enc_a_pin);
+    enc_b_irq = gpio_to_irq(enc_b_pin);
+    
+    ret = request_irq(enc_a_irq, encoder_handler, IRQF_TRIGGER_RISING | IRQF_TRIGGER_FALLING,
+                      "encoder_a_handler", NULL);
+    if (ret) {
+        pr_alert("Failed to request Encoder A IRQ\n");
+        goto fail_irq;
+    }
+    
+    ret = request_irq(enc_b_irq, encoder_handler, IRQF_TRIGGER_RISING | IRQF_TRIGGER_FALLING,
+                      "encoder_b_handler", NULL);
+    if (ret) {
+        pr_alert("Failed to request Encoder B IRQ\n");
+        free_irq(enc_a_irq, NULL);
+        goto fail_irq;
+    }
+    
+    return 0;
+    
+fail_irq:
+    gpio_free(enc_b_pin);
+fail_enc_b:
+    gpio_free(enc_a_pin);
+    return ret;
+}
+
+ // release_inputs - Frees the interrupts and GPIOs of the two input pins
+
+static void release_inputs(int pin1, int pin2) {
+    free_irq(gpio_to_irq(pin1), NULL);
+    free_irq(gpio_to_irq(pin2), NULL);
+    gpio_free(pin1);
+    gpio_free(pin2);
 }
 
   // project_init - Initializes the module
@@ -436,8 +714,17 @@ static ssize_t device_write(struct file *filp, const char __user *buffer, size_t
 
 static int __init project_init(void) {
     int ret = 0;
-    int button1_irq, button2_irq;
+    int i;
+    
+    if (num_leds < 1) {
+        pr_alert("At least one LED channel is required\n");
+        return -EINVAL;
+    }
     
+    if (pwm_engine_specialized())
+        pr_info("Using %d channel PWM engine\n", num_leds);
+    else
+        pr_info("Using generic PWM engine for %d LEDs\n", num_leds);
     
     major = register_chrdev(0, DEVICE_NAME, &project_fops);
     if (major < 0) {
@@ -488,65 +775,23 @@ static int __init project_init(void) {
     }
     
     // Sets up GPIO 
-    ret = gpio_request(LED1_PIN, "LED1");
-    if (ret) {
-        pr_alert("Failed to request LED1 GPIO\n");
-        goto fail_gpio;
-    }
-    ret = gpio_request(LED2_PIN, "LED2");
-    if (ret) {
-        pr_alert("Failed to request LED2 GPIO\n");
-        gpio_free(LED1_PIN);
-        goto fail_gpio;
-    }
-    ret = gpio_request(LED3_PIN, "LED3");
-    if (ret) {
-        pr_alert("Failed to request LED3 GPIO\n");
-        gpio_free(LED2_PIN);
-        gpio_free(LED1_PIN);
-        goto fail_gpio;
-    }
-    ret = gpio_request(BTN1_PIN, "BUTTON1");
-    if (ret) {
-        pr_alert("Failed to request BUTTON1 GPIO\n");
-        gpio_free(LED3_PIN);
-        gpio_free(LED2_PIN);
-        gpio_free(LED1_PIN);
-        goto fail_gpio;
-    }
-    ret = gpio_request(BTN2_PIN, "BUTTON2");
-    if (ret) {
-        pr_alert("Failed to request BUTTON2 GPIO\n");
-        gpio_free(BTN1_PIN);
-        gpio_free(LED3_PIN);
-        gpio_free(LED2_PIN);
-        gpio_free(LED1_PIN);
-        goto fail_gpio;
-    }
-    
-    // Configures GPIO directions 
-    gpio_direction_output(LED1_PIN, 0);  
-    gpio_direction_output(LED2_PIN, 0);
-    gpio_direction_output(LED3_PIN, 0);
-    gpio_direction_input(BTN1_PIN);      
-    gpio_direction_input(BTN2_PIN);
-    
-    // Sets up button interrupts 
-    button1_irq = gpio_to_irq(BTN1_PIN);
-    button2_irq = gpio_to_irq(BTN2_PIN);
-    
-    ret = request_irq(button1_irq, button1_handler, IRQF_TRIGGER_RISING, "button1_handler", NULL);
-    if (ret) {
-        pr_alert("Failed to request Button1 IRQ\n");
-        goto fail_irq;
+    for (i = 0; i < num_leds; i++) {
+        ret = gpio_request(led_pins[i], "LED");
+        if (ret) {
+            pr_alert("Failed to request LED%d GPIO\n", i + 1);
+            goto fail_led_gpio;
+        }
     }
+    for (i = 0; i < num_leds; i++)
+        gpio_direction_output(led_pins[i], 0);  
     
-    ret = request_irq(button2_irq, button2_handler, IRQF_TRIGGER_RISING, "button2_handler", NULL);
-    if (ret) {
-        pr_alert("Failed to request Button2 IRQ\n");
-        free_irq(button1_irq, NULL);
-        goto fail_irq;
-    }
+    // Sets up the input pins and their interrupts 
+    if (encoder_mode)
+        ret = setup_encoder();
+    else
+        ret = setup_buttons();
+    if (ret)
+        goto fail_led_gpio;
     
     
     last_press_time = ktime_get();
@@ -560,14 +805,10 @@ static int __init project_init(void) {
     pr_info("Project module initialized\n");
     return 0;
     
-fail_irq:
-    gpio_free(BTN2_PIN);
-    gpio_free(BTN1_PIN);
-    gpio_free(LED3_PIN);
-    gpio_free(LED2_PIN);
-    gpio_free(LED1_PIN);
+fail_led_gpio:
+    while (--i >= 0)
+        gpio_free(led_pins[i]);
     
-fail_gpio:
     sysfs_remove_group(project_kobj, &attr_group);
     kobject_put(project_kobj);
     device_destroy(projectClass, MKDEV(major, 0));
@@ -580,22 +821,22 @@ fail_gpio:
 // Cancels timers, releases interrupts and GPIOs, and unregisters devices
  
 static void __exit project_exit(void) {
+    int i;
+    
     // Cancels timers
     hrtimer_cancel(&pwm_timer);
     
-    // Frees interrupts 
-    free_irq(gpio_to_irq(BTN1_PIN), NULL);
-    free_irq(gpio_to_irq(BTN2_PIN), NULL);
+    // Frees interrupts and input GPIOs 
+    if (encoder_mode)
+        release_inputs(enc_a_pin, enc_b_pin);
+    else
+        release_inputs(BTN1_PIN, BTN2_PIN);
     
     // Releases GPIO
-    gpio_set_value(LED1_PIN, 0);  // Turns off LEDs 
-    gpio_set_value(LED2_PIN, 0);
-    gpio_set_value(LED3_PIN, 0);
-    gpio_free(BTN1_PIN);
-    gpio_free(BTN2_PIN);
-    gpio_free(LED1_PIN);
-    gpio_free(LED2_PIN);
-    gpio_free(LED3_PIN);
+    for (i = 0; i < num_leds; i++)
+        gpio_set_value(led_pins[i], 0);  // Turns off LEDs 
+    for (i = 0; i < num_leds; i++)
+        gpio_free(led_pins[i]);
     
     // Removes sysfs entries 
     sysfs_remove_group(project_kobj, &attr_group);
@@ -3,43 +3,104 @@
  // and sets LED duty cycles accordingly.
  
 
+mod config;
+mod metrics;
+
 use std::fs::{File, OpenOptions};
 use std::io::{Read, Write, Error};
 use std::thread::sleep;
-use std::time::Duration;
+use std::time::{Duration, Instant};
+
+use config::{Config, ConfigWatcher, SpeedSmoother, map_speed_to_duty_cycles};
+use metrics::Metrics;
 
-// Constants for sysfs paths and speed mapping
-const SYSFS_PATH: &str = "/sys/kernel/pwm_led_controller";  // Base path to sysfs entries
-const MAX_SPEED: u64 = 10;  // Max button press speed 
-const MIN_SPEED: u64 = 1;   // Min button press speed 
+// Metrics export
+const DEFAULT_METRICS_PATH: &str = "/var/lib/node_exporter/textfile_collector/pwm_led_sysfs.prom";
+const METRICS_INTERVAL: Duration = Duration::from_secs(10);  // Time between two exports
 
 fn main() -> Result<(), Error> {
     println!("Project LED Controller - Sysfs Interface");
     println!("Press Ctrl+C to exit");
     
+    let options = config::parse_args(DEFAULT_METRICS_PATH);
+    let mut metrics = Metrics::new("sysfs", options.metrics_path, METRICS_INTERVAL);
+    
+    // Watch the config before loading it, so edits made in between are not missed
+    let channels = config::led_channel_count();
+    let defaults = Config::new();
+    let mut watcher = match ConfigWatcher::new(&options.config_path) {
+        Ok(watcher) => Some(watcher),
+        Err(e) => {
+            eprintln!("Config changes will not be applied until restart: {}", e);
+            None
+        }
+    };
+    let mut config = config::load_or_defaults(&options.config_path, &defaults);
+    let mut smoother = SpeedSmoother::new();
+    let mut last_speed: Option<u64> = None;  // Speed read in the last cycle
+    let mut interval_ms = next_interval(0, true, &config);
+    
     // Main loop
     loop {
+        // Apply config changes between two cycles, only if the new sysfs path can be read
+        if config::reload(&mut watcher, &options.config_path, &defaults, &mut config,
+                          |new_config| read_speed(&new_config.sysfs_path).map(|_| ())
+                              .map_err(|e| Error::new(e.kind(), format!("{}: {}", new_config.sysfs_path, e)))) {
+            metrics.config_reloads += 1;
+        }
+        
         // Read current button press speed from sysfs
-        let speed = read_speed()?;
-        println!("Current button press speed: {} presses/second", speed);
+        let start = Instant::now();
+        let speed = read_speed(&config.sysfs_path)?;
+        metrics.read_latency.record(start.elapsed());
+        metrics.record_speed(speed);
+        if options.verbose {
+            println!("Current button press speed: {} presses/second", speed);
+        }
+        
+        // Smooth the speed, the state survives config reloads
+        let smoothed = smoother.update(speed as f64, &config);
         
         // Map speed to LED duty cycles
-        let (led1, led2, led3) = map_speed_to_duty_cycles(speed);
-        println!("Setting LED duty cycles: L1={}%, L2={}%, L3={}%", led1, led2, led3);
+        let (led1, led2, led3) = map_speed_to_duty_cycles(smoothed, &config);
+        if options.verbose {
+            println!("Setting LED duty cycles: L1={}%, L2={}%, L3={}%", led1, led2, led3);
+        }
         
         // Update LED duty cycles
-        set_led_duty_cycles(led1, led2, led3)?;
+        let write_start = Instant::now();
+        set_led_duty_cycles(&config.sysfs_path, channels, led1, led2, led3)?;
+        metrics.write_latency.record(write_start.elapsed());
+        metrics.loop_time.record(start.elapsed());
         
+        metrics.maybe_export();
         
-        sleep(Duration::from_millis(500));
+        // Sample fast while the speed is changing or the smoothing has not caught up,
+        // back off to the idle rate when stable
+        let changed = last_speed != Some(speed) || !smoother.settled(speed as f64);
+        interval_ms = next_interval(interval_ms, changed, &config);
+        last_speed = Some(speed);
+        
+        sleep(Duration::from_millis(interval_ms));
+    }
+}
+
+// next_interval - Returns the time until the next sample
+// Drops to fast_interval_ms on a change and doubles up to interval_ms while stable
+
+fn next_interval(current_ms: u64, changed: bool, config: &Config) -> u64 {
+    let fast_ms = config.fast_interval_ms.min(config.interval_ms);
+    if changed {
+        return fast_ms;
     }
+    current_ms.saturating_mul(2).clamp(fast_ms, config.interval_ms)
 }
 
 // read_speed - Reads the current button press speed from sysfs
 
-fn read_speed() -> Result<u64, Error> {
+fn read_speed(path: &str) -> Result<u64, Error> {
     // Open sysfs file for button speed
-    let mut file = File::open(format!("{}/button_speed", SYSFS_PATH))?;
+    let mut file = File::open(format!("{}/button_speed", path))?;
     let mut buffer = String::new();
     
     // Read content into buffer
@@ -51,59 +112,22 @@ fn read_speed() -> Result<u64, Error> {
 
 //set_led_duty_cycles - Sets LED duty cycles through sysfs
 
-fn set_led_duty_cycles(led1: u32, led2: u32, led3: u32) -> Result<(), Error> {
+fn set_led_duty_cycles(path: &str, channels: usize, led1: u32, led2: u32, led3: u32) -> Result<(), Error> {
     // Set LED1 duty cycle
-    let mut file = OpenOptions::new().write(true).open(format!("{}/led1_duty", SYSFS_PATH))?;
+    let mut file = OpenOptions::new().write(true).open(format!("{}/led1_duty", path))?;
     file.write_all(led1.to_string().as_bytes())?;
     
-    // Set LED2 duty cycle
-    let mut file = OpenOptions::new().write(true).open(format!("{}/led2_duty", SYSFS_PATH))?;
-    file.write_all(led2.to_string().as_bytes())?;
+    // Set LED2 duty cycle, the attribute only exists with at least two channels
+    if channels >= 2 {
+        let mut file = OpenOptions::new().write(true).open(format!("{}/led2_duty", path))?;
+        file.write_all(led2.to_string().as_bytes())?;
+    }
     
-    // Set LED3 duty cycle
-    let mut file = OpenOptions::new().write(true).open(format!("{}/led3_duty", SYSFS_PATH))?;
-    file.write_all(led3.to_string().as_bytes())?;
+    // Set LED3 duty cycle, the attribute only exists with at least three channels
+    if channels >= 3 {
+        let mut file = OpenOptions::new().write(true).open(format!("{}/led3_duty", path))?;
+        file.write_all(led3.to_string().as_bytes())?;
+    }
     
     Ok(())
 }
-
-// map_speed_to_duty_cycles - Maps button press speed to LED duty cycles
- 
-fn map_speed_to_duty_cycles(speed: u64) -> (u32, u32, u32) {
-    if speed <= MIN_SPEED {
-        // Min speed: L1 at minimum 10% L2 and L3 off
-        return (10, 0, 0);
-    } else if speed >= MAX_SPEED {
-        // Max speed: All LEDs at max
-        return (100, 100, 100);
-    } else {
-        // Scale LEDs based on speed
-        let range = MAX_SPEED - MIN_SPEED;
-        let position = speed - MIN_SPEED;
-        let percentage = (position as f64) / (range as f64);
-        
-        // Calculatea LED duty cycles:
-        // LED1: scales from 10% to 100% across the entire range
-        let led1 = 10 + (90.0 * percentage) as u32;
-        
-        // LED2: turns on at 33% of the range, scales to 100%
-        let led2 = if percentage > 0.33 { 
-            ((percentage - 0.33) * 150.0) as u32 
-        } else { 
-            0 
-        };
-        
-        // LED3: turns on at 66% of the range, scales to 100%
-        let led3 = if percentage > 0.66 { 
-            ((percentage - 0.66) * 300.0) as u32 
-        } else { 
-            0 
-        };
-        
-        // Ensure we're within bounds (0-100%)
-        let led2 = led2.min(100);
-        let led3 = led3.min(100);
-        
-        return (led1, led2, led3);
-    }
-}
\ No newline at end of file